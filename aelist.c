@@ -33,52 +33,87 @@
 #include <time.h>
 #include <unistd.h>
 
-#define SHORTOPTS      "sLn:lrhSP"
+#include "aelist.h"
+
+#define SHORTOPTS      "sLn:lrhSPdR:f:DH:U:I:"
 #define DEFAULTNPROMPT 30
 #define MAXPATHS       512
 #define MODESHORT      0
 #define MODELINE       1
 #define MODELONG       2
 #define DEFAULTMODE    MODESHORT
-
-/*
- *	_ _ E X E _ T
- *
- * structure for representing an
- * executable file
- */
-typedef struct __exe_t exe_t;
-struct __exe_t {
-	char name[2048], path[2048];
-	size_t siz;
-};
+#define POLLMS	       100 /* while sources are loading */
+#define PRIOHIST       40
+#define PRIOPATHS      30
+#define PRIOFILES      30
+#define PRIODESKTOP    20
+#define PRIOTREES      10
 
 static int mode = DEFAULTMODE;	     /* -slLr */
 static char *pv[MAXPATHS];	     /* paths from args*/
 static size_t psiz;		     /* number paths */
-static exe_t *ev;		     /* executables */
-static size_t evsiz;		     /* number executables */
+static char *rv[MAXPATHS];	     /* trees, -R */
+static size_t rsiz;		     /* number trees */
+static char *fv[MAXPATHS];	     /* files, -f */
+static size_t fsiz;		     /* number files */
+static char *dskv[2];		     /* desktop entry dirs, -D */
+static char dskhome[PATH_MAX];	     /* user's one in <dskv> */
+static char *hfile;		     /* history, -H */
+static char *ufile;		     /* index to update, -U */
+static char *ifile = AE_SYSINDEX;    /* system index, -I */
+static ae_set_t set;		     /* segments of all sources */
+static size_t nready;		     /* loaded segments */
 static int nprompt = DEFAULTNPROMPT; /* -n */
-static size_t evcap;		     /* for realloc() */
-static exe_t *last;		     /* last exe */
-static size_t totsiz;		     /* total size all binares */
+static ae_hit_t last;		     /* last exe */
+static ae_hit_t *mv;		     /* matches of search() */
+static bool typed;		     /* any key was pressed */
 static u_char Sflag;		     /* -S */
 static u_char Pflag;		     /* -P */
+static u_char dflag;		     /* -d */
+static u_char Dflag;		     /* -D */
+
+/*
+ *	S E G N A M E
+ *
+ * name of the segment for messages, with
+ * its argument if it has only one
+ */
+static const char *
+segname(const ae_segment_t *seg)
+{
+	static char buf[PATH_MAX + 32];
+
+	if (seg->src.ac != 1)
+		return seg->src.name;
+	snprintf(buf, sizeof(buf), "%s %s", seg->src.name, *seg->src.av);
+
+	return buf;
+}
 
 /*
  *	F I N I S H
  *
  * terminates the program, clears
  * memory, and returns the terminal
- * to normal mode.
+ * to normal mode; the sources that
+ * failed to load are reported.
  */
 static void noreturn
 finish(int sig)
 {
+	size_t n;
+
 	(void)sig;
 	endwin();
-	if (ev)
-		free(ev);
+	for (n = 0; n < set.siz; n++)
+		if (ae_isready(set.sv[n]) && set.sv[n]->err)
+			fprintf(stderr, "Failed load %s: %s\n",
+			    segname(set.sv[n]), strerror(set.sv[n]->err));
+	/* a source may still be blocked reading */
+	if (ae_setready(&set) == set.siz)
+		ae_setfree(&set);
+	if (mv)
+		free(mv);
 	exit(0);
 }
 
@@ -107,13 +142,18 @@ bytesfmt(size_t n)
  *		E X E C
  *
  * this function create new fork, execute
- * <last>, and close this process
+ * <last>, and close this process; commands
+ * of <AE_SHELL> sources are run by /bin/sh
  */
 static void
 exec(void)
 {
-	if (!last)
+	if (!last.e)
 		return;
+	const char *path = ae_path(&last.seg->idx, last.e);
+	if (hfile)
+		ae_addhist(hfile, ae_name(&last.seg->idx, last.e), path,
+		    last.seg->src.flags);
 	pid_t pid = fork();
 	if (pid < 0)
 		finish(0);
@@ -130,7 +170,10 @@ exec(void)
 				close(fd);
 		}
 
-		execl(last->path, last->path, NULL);
+		if (last.seg->src.flags & AE_SHELL)
+			execl("/bin/sh", "sh", "-c", path, NULL);
+		else
+			execl(path, path, NULL);
 		_exit(1);
 	}
 
@@ -163,107 +206,221 @@ parsepath(void)
 /*
  *		S E A R C H
  *
- * searches for a program by name from <in>,
- * outputs the necessary information according
- * to the mode
+ * searches for a program by name from <in> in
+ * the loaded sources, outputs the necessary
+ * information according to the mode; the best
+ * ranked hit becomes <last>. the list is only
+ * drawn if <list> is set
  */
 static void
-search(char *in)
+search(char *in, bool list)
 {
-	size_t fi = 1, sum, n;
+	ae_setquery_t q = { in, mv, nprompt };
+	const ae_index_t *idx;
+	const char *desc;
+	size_t fi, n;
 	int y, x;
-	bool s = 0;
 
 	getyx(stdscr, y, x);
-	n = sum = evsiz;
-	while (n--)
-		if (!strstr(ev[n].name, in))
-			--sum;
-
-	for (n = 0; n < evsiz && fi <= nprompt; n++) {
-		if (!strcmp(ev[n].name, in)) {
-			*last = ev[n];
-			s = 1;
-		}
-
-		if (strstr(ev[n].name, in)) {
-			if (!s)
-				last = &ev[n];
-			if (mode == MODELONG || mode == MODESHORT)
-				mvprintw((Sflag) ? 0 : 1, 0,
-				    "exec %s (%s) %ld\n", last->path,
-				    bytesfmt(ev[n].siz), sum);
-			if (mode == MODELONG) {
-				mvhline((Sflag) ? 2 : 3, 0, ACS_HLINE, 45);
-				mvprintw(fi + ((Sflag) ? 2 : 3), 0, "%s\n",
-				    ev[n].name);
-			}
-			++fi;
-		}
+	ae_setquery(&set, &q);
+
+	if (q.n > 0)
+		last = q.out[0];
+
+	if (q.n > 0 && (mode == MODELONG || mode == MODESHORT))
+		mvprintw((Sflag) ? 0 : 1, 0, "exec %s (%s) %ld\n",
+		    ae_path(&last.seg->idx, last.e), bytesfmt(last.e->siz),
+		    q.sum);
+
+	if (!list)
+		goto out;
+	for (n = 0, fi = 1; n < q.n && mode == MODELONG; n++, fi++) {
+		idx = &q.out[n].seg->idx;
+
+		mvhline((Sflag) ? 2 : 3, 0, ACS_HLINE, 45);
+		if ((desc = ae_desc(idx, q.out[n].e)))
+			mvprintw(fi + ((Sflag) ? 2 : 3), 0, "%-24s %s\n",
+			    ae_name(idx, q.out[n].e), desc);
+		else
+			mvprintw(fi + ((Sflag) ? 2 : 3), 0, "%s\n",
+			    ae_name(idx, q.out[n].e));
 	}
-	while (fi <= nprompt) {
-		move(fi++ + ((Sflag) ? 2 : 3), 0);
+	for (fi = q.n + 1; fi <= nprompt; fi++) {
+		move(fi + ((Sflag) ? 2 : 3), 0);
 		clrtoeol();
 	}
-
+out:
 	move(y, x);
 }
 
 /*
- *			I N I T
+ *		U P D A T E
  *
- * collects information about all executable files in
- * the directories specified by the user, stores them
- * in <exe_t> in the <ev> array,
+ * scans the paths into a new index and saves
+ * it to <ufile> for other runs to map, with
+ * the descriptions if asked; then terminates
+ * the program, with status 1 on error
+ */
+static void noreturn
+update(void)
+{
+	ae_index_t idx;
+
+	if (ae_init(&idx) < 0 || ae_loaddirs(&idx, pv, psiz) < 0)
+		goto err;
+	if (dflag && ae_loaddesc(&idx, AE_WHATISCMD) < 0 && errno == ENOMEM)
+		goto err;
+	if (ae_save(&idx, ufile) < 0)
+		goto err;
+
+	ae_free(&idx);
+	finish(0);
+err:
+	/* hooks and timers only see the exit status */
+	fprintf(stderr, "Failed update \"%s\": %s\n", ufile, strerror(errno));
+	ae_free(&idx);
+	exit(1);
+}
+
+/*
+ *	S Y S P A T H S
+ *
+ * if every directory of the system index <sys>
+ * is one of the paths, even through a link as
+ * /bin to /usr/bin, removes them from <pv>,
+ * so that only the other paths are scanned on
+ * top of it, and returns true
+ */
+static bool
+syspaths(const ae_index_t *sys)
+{
+	size_t n, k;
+
+	for (n = 0; n < sys->dirsiz; n++) {
+		for (k = 0; k < psiz && !ae_samedir(&sys->dirv[n], pv[k]); k++)
+			;
+		if (k == psiz)
+			return false;
+	}
+
+	for (n = k = 0; n < psiz; n++)
+		if (!ae_covers(sys, pv[n]))
+			pv[k++] = pv[n];
+	psiz = k;
+
+	return true;
+}
+
+/*
+ *	A D D S O U R C E
+ */
+static void
+addsource(const char *name, int (*load)(ae_index_t *, char *const *, size_t),
+    char *const *av, size_t ac, int prio, int flags)
+{
+	ae_source_t src = { name, load, av, ac, prio, flags };
+
+	if (ac > 0 && ae_setadd(&set, &src) < 0)
+		finish(0);
+}
+
+/*
+ *			I N I T
  *
- * allocating memory to it and increasing its size
- * every <STEP> by <STEP>.
+ * creates one segment per source given by the
+ * user: the paths together, every tree and
+ * every file apart, the desktop entries and
+ * the history, then starts loading them all
+ * and allocates <mv> for search(). the paths
+ * covered by the system index <ifile> are
+ * mapped from it instead of scanned, unless
+ * descriptions are wanted and it has none;
+ * if it has them, they are joined with the
+ * other sources in place of apropos
  */
 static void
 init(void)
 {
-	exe_t exe;
-	char buf[4096];
-	struct stat st;
-	struct dirent *d;
-	DIR *dir;
+	int descf = (dflag) ? AE_DESC : 0;
+	ae_source_t syssrc = { "system", NULL, NULL, 0, PRIOPATHS, 0 };
+	char *home = getenv("HOME");
+	ae_index_t sys = { 0 };
 	size_t n;
 
-	for (n = 0; n < psiz; n++) {
-		if (!(dir = opendir(pv[n])))
-			continue;
-		while ((d = readdir(dir))) {
-			if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
-				continue;
+	if (Dflag) {
+		dskv[0] = "/usr/share/applications";
+		if (home && snprintf(dskhome, sizeof(dskhome),
+				"%s/.local/share/applications",
+				home) < sizeof(dskhome))
+			dskv[1] = dskhome;
+	}
 
-			snprintf(buf, sizeof(buf), "%s/%s", pv[n], d->d_name);
-			if (access(buf, X_OK) != 0)
-				continue;
-			if (stat(buf, &st) < 0)
-				continue;
+	addsource("history", ae_loadhist, &hfile, (hfile) ? 1 : 0, PRIOHIST,
+	    AE_SHELL);
+	if (psiz > 0 && ae_map(&sys, ifile) == 0 &&
+	    ((dflag && !(sys.flags & AE_JOINED)) || !syspaths(&sys)))
+		ae_free(&sys);
+	if (dflag && sys.map && ae_setwhatis(&set, &sys) < 0)
+		finish(0);
+	/* the user's own paths before the system ones, as in $PATH */
+	addsource("paths", ae_loaddirs, pv, psiz, PRIOPATHS, descf);
+	if (sys.map && ae_setadopt(&set, &syssrc, &sys) < 0)
+		finish(0);
+	for (n = 0; n < fsiz; n++)
+		addsource("file", ae_loadfiles, &fv[n], 1, PRIOFILES, AE_SHELL);
+	addsource("desktop", ae_loaddesktop, dskv,
+	    (dskv[1]) ? 2 : (dskv[0] != NULL), PRIODESKTOP, AE_SHELL);
+	for (n = 0; n < rsiz; n++)
+		addsource("tree", ae_loadtrees, &rv[n], 1, PRIOTREES, descf);
 
-			if (evsiz == evcap) {
-				evcap = evcap + 1024;
-				exe_t *t = realloc(ev, evcap * sizeof(exe_t));
-				if (!t)
-					finish(0);
-				ev = t;
-			}
+	ae_setload(&set);
+
+	if (!(mv = calloc(nprompt * AE_NRANK, sizeof(ae_hit_t))))
+		finish(0);
+}
 
-			snprintf(exe.name, sizeof(exe.name), "%s", d->d_name);
-			snprintf(exe.path, sizeof(exe.path), "%s", buf);
-			exe.siz = st.st_size;
+/*
+ *		S T A T U S
+ *
+ * outputs the first line according to the
+ * loaded segments, with the first one that
+ * failed, and terminates the program if all
+ * of them are loaded and empty
+ */
+static void
+status(void)
+{
+	size_t n, files = 0, totsiz = 0, nfail = 0;
+	const ae_segment_t *fail = NULL;
+	int y, x;
 
-			totsiz += st.st_size;
-			ev[evsiz++] = exe;
-		}
-		closedir(dir);
+	nready = ae_setready(&set);
+	for (n = 0; n < set.siz; n++) {
+		if (!ae_isready(set.sv[n]))
+			continue;
+		files += set.sv[n]->idx.evsiz;
+		totsiz += set.sv[n]->idx.totsiz;
+		if (set.sv[n]->err && !nfail++)
+			fail = set.sv[n];
 	}
 
-	if (evsiz == 0) {
+	if (nready == set.siz && files == 0) {
+		endwin();
 		fprintf(stderr, "Not found files in paths!\n");
 		finish(0);
 	}
+
+	if (Sflag || mode == MODELINE)
+		return;
+
+	getyx(stdscr, y, x);
+	mvprintw(0, 0, "loaded %ld files from %ld/%ld sources (%s)", files,
+	    nready, set.siz, bytesfmt(totsiz));
+	if (fail)
+		printw(", %ld failed, %s: %s", nfail, segname(fail),
+		    strerror(fail->err));
+	printw("\n");
+	move(y, x);
 }
 
 /*
@@ -277,24 +434,28 @@ static int
 loop(void)
 {
 	int n = 0, pos = (mode == MODELINE) ? 0 : (Sflag) ? 1 : 2;
-	char in[2048];
+	char in[2048] = "";
 	chtype c;
 
-	switch (mode) {
-	case MODELONG:
-	case MODESHORT:
-		if (!Sflag)
-			mvprintw(0, 0, "loaded %ld files from %ld paths (%s)\n",
-			    evsiz, psiz, bytesfmt(totsiz));
-		mvprintw((Sflag) ? 0 : 1, 0, "exec %s (%s) %ld\n", ev->path,
-		    bytesfmt(ev->siz), evsiz);
-		break;
-	}
-
 	mvprintw(pos, 0, ": ");
+	status();
+	search(in, false);
 	refresh();
 
+	/* poll for sources that finish loading while typing */
+	timeout((nready < set.siz) ? POLLMS : -1);
 	while ((c = getch()) != '\n') {
+		if (c == ERR) {
+			if (ae_setready(&set) == nready)
+				continue;
+			status();
+			search(in, typed);
+			if (nready == set.siz)
+				timeout(-1);
+			continue;
+		}
+		typed = true;
+
 		switch (c) {
 		case KEY_BACKSPACE:
 		case 127:
@@ -312,7 +473,7 @@ loop(void)
 			break;
 		}
 		in[n] = 0;
-		search(in);
+		search(in, true);
 	}
 
 	exec();
@@ -346,6 +507,25 @@ main(int c, char **av)
 		fprintf(stderr, "  -r \t\tspecify random display mode\n");
 		fprintf(stderr, "  -S \t\tskip the very first loading info\n");
 		fprintf(stderr, "  -P \t\tload $PATH in paths\n");
+		fprintf(stderr,
+		    "  -R <dir> \tload executables under <dir>"
+		    " recursively\n");
+		fprintf(stderr,
+		    "  -f <file> \tload commands from the lines of"
+		    " <file>, - for stdin\n");
+		fprintf(stderr, "  -D \t\tload desktop entries\n");
+		fprintf(stderr,
+		    "  -U <file> \tsave the index of the paths to <file>"
+		    " and exit\n");
+		fprintf(stderr,
+		    "  -I <file> \tmap the system index from <file>"
+		    " (%s)\n", AE_SYSINDEX);
+		fprintf(stderr,
+		    "  -H <file> \tload commands from the history"
+		    " <file> and save to it\n");
+		fprintf(stderr,
+		    "  -d \t\tload descriptions from whatis,"
+		    " search them with ?<text>\n");
 		fprintf(stderr, "  -h \t\tshow this menu and exit\n");
 		fprintf(stderr, "\nReleased in %s %s\n", __DATE__, __TIME__);
 		finish(0);
@@ -359,6 +539,31 @@ main(int c, char **av)
 		case 'P':
 			++Pflag;
 			break;
+		case 'd':
+			++dflag;
+			break;
+		case 'D':
+			++Dflag;
+			break;
+		case 'R':
+			if (rsiz >= MAXPATHS)
+				goto many;
+			rv[rsiz++] = optarg;
+			break;
+		case 'f':
+			if (fsiz >= MAXPATHS)
+				goto many;
+			fv[fsiz++] = optarg;
+			break;
+		case 'H':
+			hfile = optarg;
+			break;
+		case 'U':
+			ufile = optarg;
+			break;
+		case 'I':
+			ifile = optarg;
+			break;
 		case 's':
 			mode = MODESHORT;
 			break;
@@ -405,9 +610,10 @@ main(int c, char **av)
 	c -= optind;
 	psiz += c;
 
-	if (psiz <= 0 || Pflag)
+	if ((psiz <= 0 && rsiz + fsiz + Dflag == 0) || Pflag)
 		parsepath();
 	if (psiz > MAXPATHS) {
+	many:
 		fprintf(stderr, "Too many paths!\n");
 		finish(0);
 	}
@@ -418,8 +624,19 @@ main(int c, char **av)
 	while (c--)
 		*ptr++ = *av++;
 
+	if (ufile)
+		update();
 	init();
-	initscr();
+
+	/* the standard input may be a source, read keys from the tty */
+	if (!isatty(STDIN_FILENO)) {
+		FILE *tty = fopen("/dev/tty", "r");
+		if (!tty || !newterm(NULL, stdout, tty)) {
+			fprintf(stderr, "Failed open the terminal\n");
+			finish(0);
+		}
+	} else
+		initscr();
 	cbreak();
 	noecho();
 	keypad(stdscr, TRUE);
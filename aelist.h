@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2026, Ae-foundation. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * software name includes “ae”.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS” AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT
+ * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef AELIST_H
+#define AELIST_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define AE_WHATISCMD "apropos -l . 2>/dev/null"
+#define AE_DESCQUERY '?'
+#define AE_NOEXACT   ((size_t)-1)
+#define AE_MAXDEPTH  16 /* of ae_loadtrees() */
+#define AE_NRANK     3	/* exact, prefix, substring */
+#define AE_SYSINDEX  "/var/cache/aelist/index"
+#define AE_MAGIC     "AELIST\0\5"
+
+/* flags of <ae_source_t> */
+#define AE_SHELL 0x1 /* paths are command lines for /bin/sh */
+#define AE_DESC	 0x2 /* join the whatis hash of the set after loading */
+
+/* flags of <ae_index_t> */
+#define AE_JOINED 0x1 /* ae_whatisjoin() has been run */
+
+/*
+ *	_ _ A E _ A R E N A _ T
+ *
+ * growing buffer of null terminated
+ * strings, addressed by offsets so it
+ * can be moved by realloc()
+ */
+typedef struct __ae_arena_t ae_arena_t;
+struct __ae_arena_t {
+	char *v;
+	size_t siz, cap;
+};
+
+/*
+ *	_ _ A E _ E X E _ T
+ *
+ * structure for representing an
+ * executable file, the strings are
+ * offsets in the arenas of its index;
+ * the owner and mode are kept by scans
+ * so that ae_map() can tell what the
+ * caller may run
+ */
+typedef struct __ae_exe_t ae_exe_t;
+struct __ae_exe_t {
+	size_t name, path;
+	size_t desc; /* 0 if none */
+	size_t siz;
+	uint32_t mode; /* 0 if not known */
+	uint32_t uid, gid;
+};
+
+/*
+ *	_ _ A E _ D I R _ T
+ *
+ * a directory read by ae_scan(), its path
+ * is an offset in the paths arena, its mtime
+ * is kept to the nanosecond, and its device
+ * and inode tell it apart from other paths
+ * to the same directory, as /bin and /usr/bin
+ */
+typedef struct __ae_dir_t ae_dir_t;
+struct __ae_dir_t {
+	size_t path;
+	int64_t mtime, mtimens;
+	uint64_t dev, ino;
+};
+
+/*
+ *	_ _ A E _ I N D E X _ T
+ *
+ * all executables found by ae_scan(),
+ * names, paths and descriptions live in
+ * separate arenas so that each search
+ * only walks the bytes it needs. an index
+ * mapped by ae_map() is read only, its <ev>
+ * is an owned copy if <evcap> is not 0
+ */
+typedef struct __ae_index_t ae_index_t;
+struct __ae_index_t {
+	ae_exe_t *ev;
+	size_t evsiz, evcap;
+	ae_arena_t names, paths, descs;
+	size_t totsiz; /* total size all binares */
+	ae_dir_t *dirv;
+	size_t dirsiz, dircap;
+	void *map; /* NULL if not mapped */
+	size_t mapsiz;
+	int flags;
+};
+
+/*
+ *	_ _ A E _ F H D R _ T
+ *
+ * header of an index file, followed by
+ * <evsiz> entries, <dirsiz> directories,
+ * and the names, paths and descriptions
+ * arenas of the given sizes; <flags> are
+ * those of the saved index
+ */
+typedef struct __ae_fhdr_t ae_fhdr_t;
+struct __ae_fhdr_t {
+	char magic[8];
+	uint32_t exelen, dirlen; /* sizeof the structures */
+	uint64_t evsiz, dirsiz, totsiz;
+	uint64_t names, paths, descs;
+	uint64_t flags;
+};
+
+/*
+ *	_ _ A E _ W H A T I S _ T
+ *
+ * the whatis database read by
+ * ae_whatisload() or taken from an index
+ * by ae_whatisindex(), a hash by name that
+ * ae_whatisjoin() shares between indexes
+ */
+typedef struct __ae_whatis_t ae_whatis_t;
+struct __ae_whatis_t {
+	ae_arena_t tv;
+	struct __whatis_t *hv;
+	size_t hcap;
+};
+
+/*
+ *	_ _ A E _ Q U E R Y _ T
+ *
+ * one query for ae_query() and ae_batch(),
+ * <q> and <out>/<max> are set by the caller,
+ * the rest is the result: the first <n>
+ * matches (n <= max) in <out>, <sum> matches
+ * in total, and <exact> the index of the
+ * entry with the same name, or AE_NOEXACT
+ */
+typedef struct __ae_query_t ae_query_t;
+struct __ae_query_t {
+	const char *q;
+	size_t *out, max;
+	size_t n, sum, exact;
+};
+
+/*
+ *	_ _ A E _ S O U R C E _ T
+ *
+ * where the candidates of one segment come
+ * from: <load> fills an empty index from the
+ * <ac> arguments in <av>, returning -1 with
+ * errno set on a fatal error
+ */
+typedef struct __ae_source_t ae_source_t;
+struct __ae_source_t {
+	const char *name;
+	int (*load)(ae_index_t *idx, char *const *av, size_t ac);
+	char *const *av;
+	size_t ac;
+	int prio; /* higher is shown first */
+	int flags;
+};
+
+/*
+ *	_ _ A E _ S E G M E N T _ T
+ *
+ * the index loaded from one source by its own
+ * thread, it may only be read once <ready> is
+ * set and never changes after that
+ */
+typedef struct __ae_segment_t ae_segment_t;
+struct __ae_segment_t {
+	ae_source_t src;
+	ae_index_t idx;
+	struct __ae_set_t *set;
+	int err; /* errno of a failed load, 0 if none */
+	atomic_int ready;
+	pthread_t tid;
+	bool joinable;
+};
+
+/*
+ *	_ _ A E _ S E T _ T
+ *
+ * all segments, sorted by priority once
+ * ae_setload() has started them, and the
+ * whatis hash read once for all segments
+ * with <AE_DESC>
+ */
+typedef struct __ae_set_t ae_set_t;
+struct __ae_set_t {
+	ae_segment_t **sv;
+	size_t siz, cap;
+	ae_whatis_t whatis;
+	pthread_mutex_t wlock;
+	bool wdone, loaded;
+	int werr;
+};
+
+/*
+ *	_ _ A E _ H I T _ T
+ */
+typedef struct __ae_hit_t ae_hit_t;
+struct __ae_hit_t {
+	const ae_segment_t *seg;
+	const ae_exe_t *e;
+};
+
+/*
+ *	_ _ A E _ S E T Q U E R Y _ T
+ *
+ * one query for ae_setquery(), the caller
+ * sets <q> and <max> and gives <out> room for
+ * AE_NRANK * max hits; the result is the
+ * best <n> hits (n <= max) at the start of
+ * <out>, ranked exact name, prefix, then
+ * substring, and by priority of the source
+ * within a rank, <sum> matches in total
+ */
+typedef struct __ae_setquery_t ae_setquery_t;
+struct __ae_setquery_t {
+	const char *q;
+	ae_hit_t *out;
+	size_t max;
+	size_t n, sum;
+};
+
+int ae_init(ae_index_t *idx);
+void ae_free(ae_index_t *idx);
+int ae_add(ae_index_t *idx, const char *name, const char *path, size_t siz,
+    const char *desc);
+int ae_scan(ae_index_t *idx, const char *dir);
+int ae_save(const ae_index_t *idx, const char *file);
+int ae_map(ae_index_t *idx, const char *file);
+bool ae_covers(const ae_index_t *idx, const char *dir);
+bool ae_samedir(const ae_dir_t *d, const char *dir);
+int ae_whatisload(ae_whatis_t *w, const char *cmd);
+int ae_whatisindex(ae_whatis_t *w, const ae_index_t *idx);
+int ae_whatisjoin(const ae_whatis_t *w, ae_index_t *idx);
+void ae_whatisfree(ae_whatis_t *w);
+int ae_loaddesc(ae_index_t *idx, const char *cmd);
+bool ae_match(const ae_index_t *idx, const ae_exe_t *e, const char *q);
+void ae_query(const ae_index_t *idx, ae_query_t *q);
+int ae_batch(const ae_index_t *idx, ae_query_t *qv, size_t qn, int nthreads);
+
+int ae_loaddirs(ae_index_t *idx, char *const *av, size_t ac);
+int ae_loadtrees(ae_index_t *idx, char *const *av, size_t ac);
+int ae_loadfiles(ae_index_t *idx, char *const *av, size_t ac);
+int ae_loaddesktop(ae_index_t *idx, char *const *av, size_t ac);
+int ae_loadhist(ae_index_t *idx, char *const *av, size_t ac);
+int ae_addhist(const char *file, const char *name, const char *cmd, int flags);
+
+int ae_setadd(ae_set_t *set, const ae_source_t *src);
+int ae_setadopt(ae_set_t *set, const ae_source_t *src, ae_index_t *idx);
+int ae_setwhatis(ae_set_t *set, const ae_index_t *idx);
+void ae_setload(ae_set_t *set);
+size_t ae_setready(const ae_set_t *set);
+void ae_setwait(ae_set_t *set);
+void ae_setfree(ae_set_t *set);
+void ae_setquery(const ae_set_t *set, ae_setquery_t *q);
+int ae_setbatch(const ae_set_t *set, ae_setquery_t *qv, size_t qn, int nthreads);
+
+inline static const char *
+ae_name(const ae_index_t *idx, const ae_exe_t *e)
+{
+	return idx->names.v + e->name;
+}
+
+inline static const char *
+ae_path(const ae_index_t *idx, const ae_exe_t *e)
+{
+	return idx->paths.v + e->path;
+}
+
+inline static const char *
+ae_desc(const ae_index_t *idx, const ae_exe_t *e)
+{
+	return (e->desc) ? idx->descs.v + e->desc : NULL;
+}
+
+inline static bool
+ae_isready(const ae_segment_t *seg)
+{
+	return atomic_load_explicit(&seg->ready, memory_order_acquire);
+}
+
+#endif /* AELIST_H */
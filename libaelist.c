@@ -0,0 +1,1595 @@
+/*
+ * Copyright (c) 2026, Ae-foundation. All rights reserved.
+ *
+ * Permission to use, copy, modify, and/or distribute this software for
+ * any purpose with or without fee is hereby granted, provided that the
+ * software name includes “ae”.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS” AND THE AUTHOR DISCLAIMS ALL
+ * WARRANTIES WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE
+ * FOR ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY
+ * DAMAGES WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN
+ * AN ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT
+ * OF OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "aelist.h"
+
+/*
+ *	_ _ W H A T I S _ T
+ *
+ * one entry of the whatis hash, both
+ * fields are offsets in the arena of
+ * the <ae_whatis_t>
+ */
+typedef struct __whatis_t whatis_t;
+struct __whatis_t {
+	size_t name, desc;
+};
+
+/*
+ *	_ _ B A T C H _ T
+ *
+ * the share of ae_batch() or ae_setbatch()
+ * queries given to one thread: <fn> runs
+ * every <step> query starting from <first>,
+ * over the index or the set snapshot
+ */
+typedef struct __batch_t batch_t;
+struct __batch_t {
+	void (*fn)(const struct __batch_t *b, size_t n);
+	const ae_index_t *idx;
+	ae_query_t *qv;
+	const ae_set_t *set;
+	const bool *snap; /* segments ready at the start */
+	ae_setquery_t *sqv;
+	size_t qn, first, step;
+	pthread_t tid;
+};
+
+/*
+ *	A R E N A P U T
+ *
+ * appends <len> bytes of <s> and a null
+ * byte to the arena <a>, growing it if
+ * needed; stores the offset of the copy
+ * in <off>, returns -1 if out of memory
+ */
+static int
+arenaput(ae_arena_t *a, const char *s, size_t len, size_t *off)
+{
+	if (a->siz + len + 1 > a->cap) {
+		size_t ncap = (a->cap) ? a->cap : 4096;
+		while (a->siz + len + 1 > ncap)
+			ncap *= 2;
+		char *t = realloc(a->v, ncap);
+		if (!t)
+			return -1;
+		a->v = t;
+		a->cap = ncap;
+	}
+
+	*off = a->siz;
+	memcpy(a->v + a->siz, s, len);
+	a->v[a->siz + len] = 0;
+	a->siz += len + 1;
+
+	return 0;
+}
+
+/*
+ *	H A S H S T R
+ *
+ * FNV-1a hash of the string <s>
+ */
+inline static size_t
+hashstr(const char *s)
+{
+	size_t h = 2166136261u;
+
+	while (*s)
+		h = (h ^ (u_char)*s++) * 16777619u;
+
+	return h;
+}
+
+/*
+ *	A E _ I N I T
+ *
+ * prepares an empty index, the description
+ * arena starts with an empty string so that
+ * offset 0 means "no description"
+ */
+int
+ae_init(ae_index_t *idx)
+{
+	size_t off;
+
+	memset(idx, 0, sizeof(*idx));
+
+	return arenaput(&idx->descs, "", 0, &off);
+}
+
+/*
+ *	A E _ F R E E
+ */
+void
+ae_free(ae_index_t *idx)
+{
+	if (idx->map) {
+		munmap(idx->map, idx->mapsiz);
+		if (idx->evcap)
+			free(idx->ev);
+	} else {
+		free(idx->ev);
+		free(idx->names.v);
+		free(idx->paths.v);
+		free(idx->descs.v);
+		free(idx->dirv);
+	}
+	memset(idx, 0, sizeof(*idx));
+}
+
+/*
+ *	A E _ A D D
+ *
+ * appends one entry to the index, allocating
+ * memory for <ev> in steps of 1024 entries;
+ * <desc> may be NULL. returns -1 if out of
+ * memory or the index is mapped
+ */
+int
+ae_add(ae_index_t *idx, const char *name, const char *path, size_t siz,
+    const char *desc)
+{
+	ae_exe_t exe = { 0 };
+
+	if (idx->map) {
+		errno = EROFS;
+		return -1;
+	}
+
+	if (idx->evsiz == idx->evcap) {
+		size_t ncap = idx->evcap + 1024;
+		ae_exe_t *t = realloc(idx->ev, ncap * sizeof(ae_exe_t));
+		if (!t)
+			return -1;
+		idx->ev = t;
+		idx->evcap = ncap;
+	}
+
+	if (arenaput(&idx->names, name, strlen(name), &exe.name) < 0)
+		return -1;
+	if (arenaput(&idx->paths, path, strlen(path), &exe.path) < 0)
+		return -1;
+	if (desc && *desc &&
+	    arenaput(&idx->descs, desc, strlen(desc), &exe.desc) < 0)
+		return -1;
+	exe.siz = siz;
+
+	idx->totsiz += siz;
+	idx->ev[idx->evsiz++] = exe;
+
+	return 0;
+}
+
+/*
+ *		S C A N
+ *
+ * collects information about all executable files
+ * in the directory <dir> and appends them to the
+ * index. with <depth> < 0 the subdirectories are
+ * taken as they are, otherwise they are walked
+ * down to <depth> levels, skipping hidden ones.
+ * returns -1 if <dir> can not be opened or memory
+ * runs out
+ */
+static int
+scan(ae_index_t *idx, const char *dir, int depth)
+{
+	char buf[PATH_MAX];
+	struct stat st;
+	struct dirent *d;
+	DIR *dp;
+	int len;
+
+	if (!(dp = opendir(dir)))
+		return -1;
+	while ((d = readdir(dp))) {
+		if (!strcmp(d->d_name, ".") || !strcmp(d->d_name, ".."))
+			continue;
+
+		len = snprintf(buf, sizeof(buf), "%s/%s", dir, d->d_name);
+		if (len < 0 || len >= sizeof(buf))
+			continue;
+
+		if (depth >= 0) {
+			if (lstat(buf, &st) < 0)
+				continue;
+			if (S_ISDIR(st.st_mode)) {
+				if (depth > 0 && *d->d_name != '.' &&
+				    scan(idx, buf, depth - 1) < 0 &&
+				    errno == ENOMEM)
+					goto err;
+				continue;
+			}
+		}
+
+		if (access(buf, X_OK) != 0)
+			continue;
+		if (stat(buf, &st) < 0)
+			continue;
+		/* in trees, links to directories are neither walked nor run */
+		if (depth >= 0 && !S_ISREG(st.st_mode))
+			continue;
+
+		if (ae_add(idx, d->d_name, buf, st.st_size, NULL) < 0)
+			goto err;
+		idx->ev[idx->evsiz - 1].mode = st.st_mode;
+		idx->ev[idx->evsiz - 1].uid = st.st_uid;
+		idx->ev[idx->evsiz - 1].gid = st.st_gid;
+	}
+	closedir(dp);
+
+	return 0;
+err:
+	closedir(dp);
+	errno = ENOMEM;
+
+	return -1;
+}
+
+/*
+ *	A E _ S C A N
+ *
+ * appends the executable files of the
+ * directory <dir> to the index, see scan(),
+ * and records <dir> with the mtime it had
+ * before the scan for ae_map()
+ */
+int
+ae_scan(ae_index_t *idx, const char *dir)
+{
+	struct stat st;
+	ae_dir_t d;
+
+	if (idx->map) {
+		errno = EROFS;
+		return -1;
+	}
+	if (stat(dir, &st) < 0 || scan(idx, dir, -1) < 0)
+		return -1;
+
+	if (idx->dirsiz == idx->dircap) {
+		size_t ncap = idx->dircap + 16;
+		ae_dir_t *t = realloc(idx->dirv, ncap * sizeof(ae_dir_t));
+		if (!t)
+			goto err;
+		idx->dirv = t;
+		idx->dircap = ncap;
+	}
+	if (arenaput(&idx->paths, dir, strlen(dir), &d.path) < 0)
+		goto err;
+	d.mtime = st.st_mtim.tv_sec;
+	d.mtimens = st.st_mtim.tv_nsec;
+	d.dev = st.st_dev;
+	d.ino = st.st_ino;
+	idx->dirv[idx->dirsiz++] = d;
+
+	return 0;
+err:
+	errno = ENOMEM;
+
+	return -1;
+}
+
+/*
+ *		A E _ S A V E
+ *
+ * writes the index to <file>, see <ae_fhdr_t>;
+ * the data goes to a temporary file first which
+ * then replaces <file>, so that the readers that
+ * mapped the old one keep it. returns -1 on
+ * error
+ */
+int
+ae_save(const ae_index_t *idx, const char *file)
+{
+	ae_fhdr_t h = { AE_MAGIC, sizeof(ae_exe_t), sizeof(ae_dir_t),
+		idx->evsiz, idx->dirsiz, idx->totsiz, idx->names.siz,
+		idx->paths.siz, idx->descs.siz, idx->flags };
+	char tmp[PATH_MAX];
+	FILE *fp;
+	int fd, err;
+
+	if (snprintf(tmp, sizeof(tmp), "%s.XXXXXX", file) >= sizeof(tmp)) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	if ((fd = mkstemp(tmp)) < 0)
+		return -1;
+	if (fchmod(fd, 0644) < 0 || !(fp = fdopen(fd, "w"))) {
+		err = errno;
+		close(fd);
+		goto err;
+	}
+
+	if (fwrite(&h, sizeof(h), 1, fp) != 1 ||
+	    fwrite(idx->ev, sizeof(ae_exe_t), idx->evsiz, fp) != idx->evsiz ||
+	    fwrite(idx->dirv, sizeof(ae_dir_t), idx->dirsiz, fp) !=
+		idx->dirsiz ||
+	    fwrite(idx->names.v, 1, idx->names.siz, fp) != idx->names.siz ||
+	    fwrite(idx->paths.v, 1, idx->paths.siz, fp) != idx->paths.siz ||
+	    fwrite(idx->descs.v, 1, idx->descs.siz, fp) != idx->descs.siz ||
+	    fflush(fp) != 0 || fsync(fd) < 0) {
+		err = errno;
+		fclose(fp);
+		goto err;
+	}
+	if (fclose(fp) != 0 || rename(tmp, file) < 0) {
+		err = errno;
+		goto err;
+	}
+
+	return 0;
+err:
+	unlink(tmp);
+	errno = err;
+
+	return -1;
+}
+
+/*
+ *	A R E N A O K
+ *
+ * returns true if the arena is empty
+ * or ends with a null byte, so strings
+ * in it can not run past its end
+ */
+inline static bool
+arenaok(const ae_arena_t *a)
+{
+	return a->siz == 0 || a->v[a->siz - 1] == 0;
+}
+
+/*
+ *	C A N E X E C
+ *
+ * returns true if the caller, with <euid> and
+ * the <gn> groups in <gv>, may run <e> as
+ * access(2) would tell; entries with no mode
+ * recorded are always taken
+ */
+static bool
+canexec(const ae_exe_t *e, uid_t euid, const gid_t *gv, int gn)
+{
+	int n;
+
+	if (e->mode == 0 || euid == 0)
+		return true;
+	if (e->uid == euid)
+		return e->mode & S_IXUSR;
+	for (n = 0; n < gn; n++)
+		if (e->gid == gv[n])
+			return e->mode & S_IXGRP;
+
+	return e->mode & S_IXOTH;
+}
+
+/*
+ *	M A P F I L T E R
+ *
+ * the index may be built by root, so the
+ * entries the caller can not run are left
+ * out: if there are any, <ev> becomes an
+ * owned copy of the others, pointing into
+ * the same mapped arenas. returns -1 if out
+ * of memory
+ */
+static int
+mapfilter(ae_index_t *idx)
+{
+	uid_t euid = geteuid();
+	gid_t *gv = NULL;
+	ae_exe_t *ev;
+	size_t n, k;
+	int gn;
+
+	if ((gn = getgroups(0, NULL)) < 0)
+		gn = 0;
+	if (!(gv = malloc((gn + 1) * sizeof(gid_t))))
+		return -1;
+	if ((gn = getgroups(gn, gv)) < 0)
+		gn = 0;
+	gv[gn++] = getegid();
+
+	for (n = 0; n < idx->evsiz; n++)
+		if (!canexec(&idx->ev[n], euid, gv, gn))
+			break;
+	if (n == idx->evsiz) {
+		free(gv);
+		return 0;
+	}
+
+	if (!(ev = malloc(idx->evsiz * sizeof(ae_exe_t)))) {
+		free(gv);
+		return -1;
+	}
+	idx->totsiz = 0;
+	for (n = k = 0; n < idx->evsiz; n++) {
+		if (!canexec(&idx->ev[n], euid, gv, gn))
+			continue;
+		idx->totsiz += idx->ev[n].siz;
+		ev[k++] = idx->ev[n];
+	}
+	free(gv);
+
+	idx->ev = ev;
+	idx->evsiz = k;
+	idx->evcap = (k) ? k : 1;
+
+	return 0;
+}
+
+/*
+ *		A E _ M A P
+ *
+ * maps the index written by ae_save() to <file>
+ * read only into <idx>. every offset is checked
+ * so that a broken file can not be read past
+ * its end, and every directory must still have
+ * the mtime it had when scanned, otherwise the
+ * index is stale. entries the caller can not
+ * run are left out, see mapfilter(). returns
+ * -1 with errno set to EINVAL for a broken file
+ * or ESTALE for a stale one
+ */
+int
+ae_map(ae_index_t *idx, const char *file)
+{
+	const ae_fhdr_t *h;
+	struct stat st;
+	size_t n, siz;
+	char *p;
+	int fd;
+
+	memset(idx, 0, sizeof(*idx));
+
+	if ((fd = open(file, O_RDONLY)) < 0)
+		return -1;
+	if (fstat(fd, &st) < 0) {
+		close(fd);
+		return -1;
+	}
+	if (st.st_size < sizeof(ae_fhdr_t)) {
+		close(fd);
+		errno = EINVAL;
+		return -1;
+	}
+	p = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (p == MAP_FAILED)
+		return -1;
+
+	idx->map = p;
+	idx->mapsiz = st.st_size;
+	h = (const ae_fhdr_t *)p;
+
+	if (memcmp(h->magic, AE_MAGIC, sizeof(h->magic)) ||
+	    h->exelen != sizeof(ae_exe_t) || h->dirlen != sizeof(ae_dir_t))
+		goto inval;
+	siz = sizeof(*h);
+	if (h->evsiz > (idx->mapsiz - siz) / sizeof(ae_exe_t))
+		goto inval;
+	siz += h->evsiz * sizeof(ae_exe_t);
+	if (h->dirsiz > (idx->mapsiz - siz) / sizeof(ae_dir_t))
+		goto inval;
+	siz += h->dirsiz * sizeof(ae_dir_t);
+	if (h->names > idx->mapsiz - siz ||
+	    h->paths > idx->mapsiz - siz - h->names ||
+	    h->descs != idx->mapsiz - siz - h->names - h->paths)
+		goto inval;
+
+	idx->ev = (ae_exe_t *)(p + sizeof(*h));
+	idx->evsiz = h->evsiz;
+	idx->dirv = (ae_dir_t *)(idx->ev + h->evsiz);
+	idx->dirsiz = h->dirsiz;
+	idx->names = (ae_arena_t) { p + siz, h->names, 0 };
+	idx->paths = (ae_arena_t) { p + siz + h->names, h->paths, 0 };
+	idx->descs = (ae_arena_t) { p + siz + h->names + h->paths, h->descs,
+		0 };
+	idx->totsiz = h->totsiz;
+	idx->flags = h->flags;
+
+	if (!arenaok(&idx->names) || !arenaok(&idx->paths) ||
+	    !arenaok(&idx->descs))
+		goto inval;
+	for (n = 0; n < idx->evsiz; n++)
+		if (idx->ev[n].name >= idx->names.siz ||
+		    idx->ev[n].path >= idx->paths.siz ||
+		    (idx->ev[n].desc && idx->ev[n].desc >= idx->descs.siz))
+			goto inval;
+
+	for (n = 0; n < idx->dirsiz; n++) {
+		if (idx->dirv[n].path >= idx->paths.siz)
+			goto inval;
+		if (stat(idx->paths.v + idx->dirv[n].path, &st) < 0 ||
+		    st.st_mtim.tv_sec != idx->dirv[n].mtime ||
+		    st.st_mtim.tv_nsec != idx->dirv[n].mtimens) {
+			ae_free(idx);
+			errno = ESTALE;
+			return -1;
+		}
+	}
+
+	if (mapfilter(idx) < 0) {
+		ae_free(idx);
+		errno = ENOMEM;
+		return -1;
+	}
+
+	return 0;
+inval:
+	ae_free(idx);
+	errno = EINVAL;
+
+	return -1;
+}
+
+/*
+ *	A E _ S A M E D I R
+ *
+ * returns true if <dir> is the directory <d>,
+ * whatever the path it is reached through
+ */
+bool
+ae_samedir(const ae_dir_t *d, const char *dir)
+{
+	struct stat st;
+
+	return stat(dir, &st) == 0 && st.st_dev == d->dev &&
+	    st.st_ino == d->ino;
+}
+
+/*
+ *	A E _ C O V E R S
+ *
+ * returns true if <dir> was scanned into
+ * the index, see ae_samedir()
+ */
+bool
+ae_covers(const ae_index_t *idx, const char *dir)
+{
+	size_t n;
+
+	for (n = 0; n < idx->dirsiz; n++)
+		if (ae_samedir(&idx->dirv[n], dir))
+			return true;
+
+	return false;
+}
+
+/*
+ *	W H A T I S H A S H
+ *
+ * builds the hash of <w> from the <hn> pairs
+ * in <wv>, whose strings are in its arena;
+ * the first pair of a name wins. returns -1
+ * if out of memory
+ */
+static int
+whatishash(ae_whatis_t *w, const whatis_t *wv, size_t hn)
+{
+	size_t n, h;
+
+	if (hn == 0)
+		return 0;
+
+	for (w->hcap = 1; w->hcap < hn * 2; w->hcap <<= 1)
+		;
+	if (!(w->hv = calloc(w->hcap, sizeof(whatis_t))))
+		return -1;
+
+	/* offset 0 is the first name, so a desc of 0 marks a free slot */
+	for (n = 0; n < hn; n++) {
+		h = hashstr(w->tv.v + wv[n].name) & (w->hcap - 1);
+		for (; w->hv[h].desc; h = (h + 1) & (w->hcap - 1))
+			if (!strcmp(w->tv.v + w->hv[h].name,
+				w->tv.v + wv[n].name))
+				break;
+		if (!w->hv[h].desc)
+			w->hv[h] = wv[n];
+	}
+
+	return 0;
+}
+
+/*
+ *		A E _ W H A T I S L O A D
+ *
+ * reads the whatis database once through
+ * <cmd> and keeps only the sections with
+ * commands (1, 6, 8) in a hash by name, the
+ * first page of a name wins. returns -1 if
+ * <cmd> can not be run or memory runs out
+ */
+int
+ae_whatisload(ae_whatis_t *w, const char *cmd)
+{
+	char line[4096], *p, *name, *desc;
+	size_t hn = 0, wvcap = 0;
+	whatis_t *wv = NULL;
+	int ret = -1;
+	FILE *fp;
+
+	memset(w, 0, sizeof(*w));
+
+	if (!(fp = popen(cmd, "r")))
+		return -1;
+
+	while (fgets(line, sizeof(line), fp)) {
+		line[strcspn(line, "\n")] = 0;
+		if (!(desc = strstr(line, " - ")))
+			continue;
+		*desc = 0;
+		desc += 3;
+
+		name = line;
+		if (!(p = strchr(name, ' ')))
+			continue;
+		*p++ = 0;
+		if (!(p = strchr(p, '(')) || !strchr("168", p[1]))
+			continue;
+
+		if (hn == wvcap) {
+			wvcap = wvcap + 1024;
+			whatis_t *t = realloc(wv, wvcap * sizeof(whatis_t));
+			if (!t)
+				goto out;
+			wv = t;
+		}
+		if (arenaput(&w->tv, name, strlen(name), &wv[hn].name) < 0)
+			goto out;
+		if (arenaput(&w->tv, desc, strlen(desc), &wv[hn].desc) < 0)
+			goto out;
+		++hn;
+	}
+
+	ret = whatishash(w, wv, hn);
+out:
+	pclose(fp);
+	free(wv);
+	if (ret < 0) {
+		ae_whatisfree(w);
+		errno = ENOMEM;
+	}
+
+	return ret;
+}
+
+/*
+ *	A E _ W H A T I S I N D E X
+ *
+ * builds the hash <w> from the descriptions
+ * already joined into <idx>, such as a system
+ * index saved with them, so that other indexes
+ * can be joined without running apropos.
+ * returns -1 if out of memory
+ */
+int
+ae_whatisindex(ae_whatis_t *w, const ae_index_t *idx)
+{
+	const char *name, *desc;
+	whatis_t *wv;
+	size_t n, hn = 0;
+	int ret = -1;
+
+	memset(w, 0, sizeof(*w));
+
+	if (!(wv = malloc((idx->evsiz + 1) * sizeof(whatis_t))))
+		goto out;
+	for (n = 0; n < idx->evsiz; n++) {
+		if (!(desc = ae_desc(idx, &idx->ev[n])))
+			continue;
+		name = ae_name(idx, &idx->ev[n]);
+		if (arenaput(&w->tv, name, strlen(name), &wv[hn].name) < 0 ||
+		    arenaput(&w->tv, desc, strlen(desc), &wv[hn].desc) < 0)
+			goto out;
+		++hn;
+	}
+
+	ret = whatishash(w, wv, hn);
+out:
+	free(wv);
+	if (ret < 0) {
+		ae_whatisfree(w);
+		errno = ENOMEM;
+	}
+
+	return ret;
+}
+
+/*
+ *	A E _ W H A T I S J O I N
+ *
+ * joins the hash <w> with the index by name
+ * and copies the matched descriptions into
+ * its arena, so that only the descriptions
+ * in use stay in memory. <w> is only read,
+ * one hash can serve many indexes at once.
+ * marks the index <AE_JOINED>, even if no
+ * name matched
+ */
+int
+ae_whatisjoin(const ae_whatis_t *w, ae_index_t *idx)
+{
+	const char *name, *desc;
+	size_t n, h, off;
+
+	if (idx->map) {
+		errno = EROFS;
+		return -1;
+	}
+	idx->flags |= AE_JOINED;
+	if (w->hcap == 0)
+		return 0;
+
+	for (n = 0; n < idx->evsiz; n++) {
+		name = idx->names.v + idx->ev[n].name;
+		h = hashstr(name) & (w->hcap - 1);
+		for (; w->hv[h].desc; h = (h + 1) & (w->hcap - 1)) {
+			if (strcmp(w->tv.v + w->hv[h].name, name))
+				continue;
+			desc = w->tv.v + w->hv[h].desc;
+			if (arenaput(&idx->descs, desc, strlen(desc), &off) < 0) {
+				errno = ENOMEM;
+				return -1;
+			}
+			idx->ev[n].desc = off;
+			break;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ *	A E _ W H A T I S F R E E
+ */
+void
+ae_whatisfree(ae_whatis_t *w)
+{
+	free(w->tv.v);
+	free(w->hv);
+	memset(w, 0, sizeof(*w));
+}
+
+/*
+ *	A E _ L O A D D E S C
+ *
+ * adds the descriptions of the whatis
+ * database read through <cmd> to a single
+ * index, see ae_whatisload()
+ */
+int
+ae_loaddesc(ae_index_t *idx, const char *cmd)
+{
+	ae_whatis_t w;
+	int ret;
+
+	if (idx->map) {
+		errno = EROFS;
+		return -1;
+	}
+	if (ae_whatisload(&w, cmd) < 0)
+		return -1;
+	ret = ae_whatisjoin(&w, idx);
+	ae_whatisfree(&w);
+
+	return ret;
+}
+
+/*
+ *	A E _ M A T C H
+ *
+ * returns true if <e> matches the query <q>,
+ * queries starting with <AE_DESCQUERY> are
+ * looked up in the description instead of
+ * the name
+ */
+bool
+ae_match(const ae_index_t *idx, const ae_exe_t *e, const char *q)
+{
+	if (*q == AE_DESCQUERY)
+		return e->desc && strstr(idx->descs.v + e->desc, q + 1);
+	return strstr(idx->names.v + e->name, q);
+}
+
+/*
+ *	A E _ Q U E R Y
+ *
+ * evaluates one query over the whole index
+ * in a single pass, see <ae_query_t>
+ */
+void
+ae_query(const ae_index_t *idx, ae_query_t *q)
+{
+	size_t n;
+
+	q->n = q->sum = 0;
+	q->exact = AE_NOEXACT;
+
+	for (n = 0; n < idx->evsiz; n++) {
+		if (!ae_match(idx, &idx->ev[n], q->q))
+			continue;
+		if (q->exact == AE_NOEXACT &&
+		    !strcmp(idx->names.v + idx->ev[n].name, q->q))
+			q->exact = n;
+		if (q->n < q->max)
+			q->out[q->n++] = n;
+		++q->sum;
+	}
+}
+
+/*
+ *	B A T C H W O R K
+ */
+static void *
+batchwork(void *arg)
+{
+	batch_t *b = arg;
+	size_t n;
+
+	for (n = b->first; n < b->qn; n += b->step)
+		b->fn(b, n);
+
+	return NULL;
+}
+
+/*
+ *		B A T C H R U N
+ *
+ * runs the <qn> queries of <proto> spread over
+ * <nthreads> threads (all online cpus if <= 0),
+ * the queries of the threads that fail to start
+ * run in the caller. returns -1 if out of memory
+ */
+static int
+batchrun(const batch_t *proto, size_t qn, int nthreads)
+{
+	batch_t *bv;
+	size_t n, nt;
+
+	if (nthreads <= 0) {
+		long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+		nthreads = (ncpu > 0) ? ncpu : 1;
+	}
+	nt = ((size_t)nthreads < qn) ? (size_t)nthreads : qn;
+
+	if (nt <= 1) {
+		for (n = 0; n < qn; n++)
+			proto->fn(proto, n);
+		return 0;
+	}
+
+	if (!(bv = calloc(nt, sizeof(batch_t))))
+		return -1;
+
+	for (n = 0; n < nt; n++) {
+		bv[n] = *proto;
+		bv[n].qn = qn;
+		bv[n].first = n;
+		bv[n].step = nt;
+		if (pthread_create(&bv[n].tid, NULL, batchwork, &bv[n]) != 0)
+			break;
+	}
+
+	if (n < nt) {
+		for (size_t i = n; i < nt; i++) {
+			bv[i] = *proto;
+			bv[i].qn = qn;
+			bv[i].first = i;
+			bv[i].step = nt;
+			batchwork(&bv[i]);
+		}
+		nt = n;
+	}
+
+	while (nt--)
+		pthread_join(bv[nt].tid, NULL);
+	free(bv);
+
+	return 0;
+}
+
+/*
+ *	B A T C H I D X
+ */
+static void
+batchidx(const batch_t *b, size_t n)
+{
+	ae_query(b->idx, &b->qv[n]);
+}
+
+/*
+ *		A E _ B A T C H
+ *
+ * evaluates <qn> queries over one snapshot of
+ * the index, spread over <nthreads> threads
+ * (all online cpus if <= 0). the index is only
+ * read, so the caller must not change it until
+ * this returns. returns -1 if out of memory
+ */
+int
+ae_batch(const ae_index_t *idx, ae_query_t *qv, size_t qn, int nthreads)
+{
+	batch_t b = { batchidx, idx, qv };
+
+	return batchrun(&b, qn, nthreads);
+}
+
+/*
+ *	A E _ L O A D D I R S
+ *
+ * source of the executables in the directories
+ * <av>, those that can not be opened are skipped
+ */
+int
+ae_loaddirs(ae_index_t *idx, char *const *av, size_t ac)
+{
+	size_t n;
+
+	for (n = 0; n < ac; n++)
+		if (ae_scan(idx, av[n]) < 0 && errno == ENOMEM)
+			return -1;
+
+	return 0;
+}
+
+/*
+ *	A E _ L O A D T R E E S
+ *
+ * source of the executables anywhere under the
+ * directories <av>, down to <AE_MAXDEPTH> levels
+ */
+int
+ae_loadtrees(ae_index_t *idx, char *const *av, size_t ac)
+{
+	size_t n;
+
+	for (n = 0; n < ac; n++)
+		if (scan(idx, av[n], AE_MAXDEPTH) < 0 && errno == ENOMEM)
+			return -1;
+
+	return 0;
+}
+
+/*
+ *	L O A D L I N E S
+ *
+ * appends every non empty line of <fp>
+ * as an entry, the line is both its name
+ * and its command
+ */
+static int
+loadlines(ae_index_t *idx, FILE *fp)
+{
+	char *line = NULL;
+	size_t cap = 0;
+	int ret = 0;
+
+	while (getline(&line, &cap, fp) > 0) {
+		line[strcspn(line, "\n")] = 0;
+		if (!*line)
+			continue;
+		if (ae_add(idx, line, line, 0, NULL) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+	free(line);
+
+	return ret;
+}
+
+/*
+ *	A E _ L O A D F I L E S
+ *
+ * source of the lines of the files <av>,
+ * "-" is the standard input. returns -1 if
+ * a file can not be opened
+ */
+int
+ae_loadfiles(ae_index_t *idx, char *const *av, size_t ac)
+{
+	size_t n;
+	FILE *fp;
+	int ret;
+
+	for (n = 0; n < ac; n++) {
+		if (!strcmp(av[n], "-")) {
+			if (loadlines(idx, stdin) < 0)
+				return -1;
+			continue;
+		}
+		if (!(fp = fopen(av[n], "r")))
+			return -1;
+		ret = loadlines(idx, fp);
+		fclose(fp);
+		if (ret < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ *	D E S K T O P
+ *
+ * appends the application described by the
+ * desktop entry <file>: its Name, its Exec
+ * line without the field codes, and its
+ * Comment as the description. hidden entries
+ * and other types are skipped
+ */
+static int
+desktop(ae_index_t *idx, const char *file)
+{
+	char line[4096], name[4096] = "", exec[4096] = "", desc[4096] = "";
+	bool group = false, hide = false;
+	char *s, *d;
+	FILE *fp;
+
+	if (!(fp = fopen(file, "r")))
+		return 0;
+
+	while (fgets(line, sizeof(line), fp)) {
+		line[strcspn(line, "\r\n")] = 0;
+		if (*line == '[') {
+			if (group)
+				break;
+			group = !strcmp(line, "[Desktop Entry]");
+			continue;
+		}
+		if (!group)
+			continue;
+
+		if (!strncmp(line, "Name=", 5) && !*name)
+			snprintf(name, sizeof(name), "%s", line + 5);
+		else if (!strncmp(line, "Exec=", 5) && !*exec)
+			snprintf(exec, sizeof(exec), "%s", line + 5);
+		else if (!strncmp(line, "Comment=", 8) && !*desc)
+			snprintf(desc, sizeof(desc), "%s", line + 8);
+		else if (!strcmp(line, "NoDisplay=true") ||
+		    !strcmp(line, "Hidden=true"))
+			hide = true;
+		else if (!strncmp(line, "Type=", 5) &&
+		    strcmp(line + 5, "Application"))
+			hide = true;
+	}
+	fclose(fp);
+
+	if (hide || !*name || !*exec)
+		return 0;
+
+	/* %% is a literal %, any other %<c> is dropped */
+	for (s = d = exec; *s; s++) {
+		if (*s != '%')
+			*d++ = *s;
+		else if (s[1] == '%')
+			*d++ = *++s;
+		else if (s[1])
+			++s;
+	}
+	while (d > exec && d[-1] == ' ')
+		--d;
+	*d = 0;
+
+	return ae_add(idx, name, exec, 0, desc);
+}
+
+/*
+ *	A E _ L O A D D E S K T O P
+ *
+ * source of the desktop entries (*.desktop)
+ * in the directories <av>
+ */
+int
+ae_loaddesktop(ae_index_t *idx, char *const *av, size_t ac)
+{
+	char buf[PATH_MAX];
+	struct dirent *d;
+	size_t n, len;
+	DIR *dp;
+
+	for (n = 0; n < ac; n++) {
+		if (!(dp = opendir(av[n])))
+			continue;
+		while ((d = readdir(dp))) {
+			len = strlen(d->d_name);
+			if (len <= 8 || strcmp(d->d_name + len - 8, ".desktop"))
+				continue;
+			if (snprintf(buf, sizeof(buf), "%s/%s", av[n],
+				d->d_name) >= sizeof(buf))
+				continue;
+			if (desktop(idx, buf) < 0) {
+				closedir(dp);
+				errno = ENOMEM;
+				return -1;
+			}
+		}
+		closedir(dp);
+	}
+
+	return 0;
+}
+
+/*
+ *	A E _ L O A D H I S T
+ *
+ * source of the lines of the history files
+ * <av>, the most recent first and each line
+ * only once. a line is "name<tab>command"
+ * as written by ae_addhist(), or a command
+ * alone that is also its name. a file that
+ * does not exist yet is empty
+ */
+int
+ae_loadhist(ae_index_t *idx, char *const *av, size_t ac)
+{
+	size_t *hv, hcap, n, h;
+	const char *line;
+	char *name, *cmd;
+	ae_index_t tv;
+	int ret = -1;
+
+	if (ae_init(&tv) < 0)
+		goto out;
+	for (n = 0; n < ac; n++)
+		if (ae_loadfiles(&tv, &av[n], 1) < 0 && errno != ENOENT)
+			goto out;
+
+	ret = 0;
+	if (tv.evsiz == 0)
+		goto out;
+
+	for (hcap = 1; hcap < tv.evsiz * 2; hcap <<= 1)
+		;
+	if (!(hv = calloc(hcap, sizeof(size_t)))) {
+		ret = -1;
+		goto out;
+	}
+
+	/*
+	 * slots keep the entry number plus one, 0 is free; lines are
+	 * compared in the paths arena, names are split in place
+	 */
+	for (n = tv.evsiz; n-- > 0;) {
+		line = ae_path(&tv, &tv.ev[n]);
+		h = hashstr(line) & (hcap - 1);
+		for (; hv[h]; h = (h + 1) & (hcap - 1))
+			if (!strcmp(ae_path(&tv, &tv.ev[hv[h] - 1]), line))
+				break;
+		if (hv[h])
+			continue;
+		hv[h] = n + 1;
+
+		name = tv.names.v + tv.ev[n].name;
+		if ((cmd = strchr(name, '\t')))
+			*cmd++ = 0;
+		else
+			cmd = name;
+		if (ae_add(idx, name, cmd, 0, NULL) < 0) {
+			ret = -1;
+			break;
+		}
+	}
+
+	free(hv);
+out:
+	ae_free(&tv);
+
+	return ret;
+}
+
+/*
+ *	A E _ A D D H I S T
+ *
+ * appends "name<tab>command" to the history
+ * <file>. <cmd> is quoted for /bin/sh unless
+ * <flags> has <AE_SHELL>, i.e. it is already a
+ * command line. entries that can not be kept
+ * on one line are refused with EINVAL
+ */
+int
+ae_addhist(const char *file, const char *name, const char *cmd, int flags)
+{
+	const char *s;
+	FILE *fp;
+	int ret;
+
+	if (strpbrk(name, "\t\n") || strchr(cmd, '\n')) {
+		errno = EINVAL;
+		return -1;
+	}
+	if (!(fp = fopen(file, "a")))
+		return -1;
+
+	fprintf(fp, "%s\t", name);
+	if (flags & AE_SHELL)
+		fputs(cmd, fp);
+	else {
+		fputc('\'', fp);
+		for (s = cmd; *s; s++)
+			if (*s == '\'')
+				fputs("'\\''", fp);
+			else
+				fputc(*s, fp);
+		fputc('\'', fp);
+	}
+	ret = (fputc('\n', fp) == EOF) ? -1 : 0;
+	if (fclose(fp) != 0)
+		ret = -1;
+
+	return ret;
+}
+
+/*
+ *	A E _ S E T A D D
+ *
+ * adds an empty segment for <src> to the set,
+ * must be called before ae_setload(). returns
+ * -1 if out of memory
+ */
+int
+ae_setadd(ae_set_t *set, const ae_source_t *src)
+{
+	ae_segment_t *seg;
+
+	if (set->siz == set->cap) {
+		size_t ncap = set->cap + 16;
+		ae_segment_t **t = realloc(set->sv, ncap * sizeof(*t));
+		if (!t)
+			return -1;
+		set->sv = t;
+		set->cap = ncap;
+	}
+
+	if (!(seg = calloc(1, sizeof(*seg))))
+		return -1;
+	if (ae_init(&seg->idx) < 0) {
+		free(seg);
+		return -1;
+	}
+	seg->src = *src;
+	seg->set = set;
+	atomic_init(&seg->ready, 0);
+	set->sv[set->siz++] = seg;
+
+	return 0;
+}
+
+/*
+ *	A E _ S E T A D O P T
+ *
+ * adds a segment for <src> that is already
+ * loaded with <idx>, which is moved into it
+ * and left empty. returns -1 if out of memory
+ */
+int
+ae_setadopt(ae_set_t *set, const ae_source_t *src, ae_index_t *idx)
+{
+	ae_segment_t *seg;
+
+	if (ae_setadd(set, src) < 0)
+		return -1;
+
+	seg = set->sv[set->siz - 1];
+	ae_free(&seg->idx);
+	seg->idx = *idx;
+	memset(idx, 0, sizeof(*idx));
+	atomic_store_explicit(&seg->ready, 1, memory_order_release);
+
+	return 0;
+}
+
+/*
+ *	S E G D E S C
+ *
+ * joins the segment with the whatis hash of
+ * its set, the first segment to get here
+ * reads it, the others wait and share it
+ */
+static int
+segdesc(ae_segment_t *seg)
+{
+	ae_set_t *set = seg->set;
+	int err;
+
+	pthread_mutex_lock(&set->wlock);
+	if (!set->wdone) {
+		/* without whatis there are just no descriptions */
+		if (ae_whatisload(&set->whatis, AE_WHATISCMD) < 0 &&
+		    errno == ENOMEM)
+			set->werr = ENOMEM;
+		set->wdone = true;
+	}
+	err = set->werr;
+	pthread_mutex_unlock(&set->wlock);
+
+	if (err) {
+		errno = err;
+		return -1;
+	}
+
+	return ae_whatisjoin(&set->whatis, &seg->idx);
+}
+
+/*
+ *	A E _ S E T W H A T I S
+ *
+ * gives the set the whatis hash of <idx>, see
+ * ae_whatisindex(), instead of reading it
+ * through apropos; must be called before
+ * ae_setload(). returns -1 if out of memory
+ */
+int
+ae_setwhatis(ae_set_t *set, const ae_index_t *idx)
+{
+	ae_whatisfree(&set->whatis);
+	if (ae_whatisindex(&set->whatis, idx) < 0)
+		return -1;
+	set->wdone = true;
+
+	return 0;
+}
+
+/*
+ *	S E G L O A D
+ *
+ * loads one segment, then publishes it
+ */
+static void *
+segload(void *arg)
+{
+	ae_segment_t *seg = arg;
+
+	if (seg->src.load(&seg->idx, seg->src.av, seg->src.ac) < 0)
+		seg->err = errno;
+	else if ((seg->src.flags & AE_DESC) && segdesc(seg) < 0)
+		seg->err = errno;
+
+	atomic_store_explicit(&seg->ready, 1, memory_order_release);
+
+	return NULL;
+}
+
+/*
+ *		A E _ S E T L O A D
+ *
+ * sorts the segments by priority, keeping the
+ * order of addition between equal ones, and
+ * starts loading each one not yet loaded on
+ * its own thread; a segment whose thread can
+ * not be started is loaded before returning
+ */
+void
+ae_setload(ae_set_t *set)
+{
+	ae_segment_t *seg;
+	size_t n, i;
+
+	pthread_mutex_init(&set->wlock, NULL);
+	set->loaded = true;
+
+	for (n = 1; n < set->siz; n++) {
+		seg = set->sv[n];
+		for (i = n; i > 0 && set->sv[i - 1]->src.prio < seg->src.prio;
+		     i--)
+			set->sv[i] = set->sv[i - 1];
+		set->sv[i] = seg;
+	}
+
+	for (n = 0; n < set->siz; n++) {
+		seg = set->sv[n];
+		if (ae_isready(seg))
+			continue;
+		seg->joinable =
+		    !pthread_create(&seg->tid, NULL, segload, seg);
+		if (!seg->joinable)
+			segload(seg);
+	}
+}
+
+/*
+ *	A E _ S E T R E A D Y
+ *
+ * returns the number of loaded segments
+ */
+size_t
+ae_setready(const ae_set_t *set)
+{
+	size_t n, sum = 0;
+
+	for (n = 0; n < set->siz; n++)
+		if (ae_isready(set->sv[n]))
+			++sum;
+
+	return sum;
+}
+
+/*
+ *	A E _ S E T W A I T
+ *
+ * waits until all segments are loaded
+ */
+void
+ae_setwait(ae_set_t *set)
+{
+	size_t n;
+
+	for (n = 0; n < set->siz; n++) {
+		if (!set->sv[n]->joinable)
+			continue;
+		pthread_join(set->sv[n]->tid, NULL);
+		set->sv[n]->joinable = false;
+	}
+}
+
+/*
+ *	A E _ S E T F R E E
+ */
+void
+ae_setfree(ae_set_t *set)
+{
+	size_t n;
+
+	ae_setwait(set);
+	for (n = 0; n < set->siz; n++) {
+		ae_free(&set->sv[n]->idx);
+		free(set->sv[n]);
+	}
+	free(set->sv);
+	ae_whatisfree(&set->whatis);
+	if (set->loaded)
+		pthread_mutex_destroy(&set->wlock);
+	memset(set, 0, sizeof(*set));
+}
+
+/*
+ *	R A N K
+ *
+ * returns the rank of <e> for the query <q>
+ * of <qlen> bytes: 0 for the whole string,
+ * 1 for a prefix, 2 for a substring, and -1
+ * if it does not match
+ */
+inline static int
+rank(const ae_index_t *idx, const ae_exe_t *e, const char *q, size_t qlen)
+{
+	const char *s, *p;
+
+	if (*q == AE_DESCQUERY) {
+		if (!e->desc)
+			return -1;
+		s = idx->descs.v + e->desc;
+		++q;
+		--qlen;
+	} else
+		s = idx->names.v + e->name;
+
+	if (!(p = strstr(s, q)))
+		return -1;
+	if (p != s)
+		return 2;
+
+	return (s[qlen]) ? 1 : 0;
+}
+
+/*
+ *		S E T Q U E R Y
+ *
+ * evaluates one query over the segments marked
+ * in <snap>, or over the loaded ones if it is
+ * NULL, see <ae_setquery_t>. every rank is
+ * gathered in its own part of <out> in one
+ * pass, then the parts are joined
+ */
+static void
+setquery(const ae_set_t *set, const bool *snap, ae_setquery_t *q)
+{
+	size_t nv[AE_NRANK] = { 0 }, qlen = strlen(q->q), n, i, k;
+	const ae_segment_t *seg;
+	int r;
+
+	q->n = q->sum = 0;
+
+	for (n = 0; n < set->siz; n++) {
+		seg = set->sv[n];
+		if ((snap) ? !snap[n] : !ae_isready(seg))
+			continue;
+		for (i = 0; i < seg->idx.evsiz; i++) {
+			r = rank(&seg->idx, &seg->idx.ev[i], q->q, qlen);
+			if (r < 0)
+				continue;
+			++q->sum;
+			if (nv[r] < q->max)
+				q->out[r * q->max + nv[r]++] =
+				    (ae_hit_t) { seg, &seg->idx.ev[i] };
+		}
+	}
+
+	for (r = 0; r < AE_NRANK && q->n < q->max; r++) {
+		k = (nv[r] < q->max - q->n) ? nv[r] : q->max - q->n;
+		memmove(q->out + q->n, q->out + r * q->max,
+		    k * sizeof(ae_hit_t));
+		q->n += k;
+	}
+}
+
+/*
+ *	A E _ S E T Q U E R Y
+ *
+ * evaluates one query over the loaded segments,
+ * those still loading are skipped
+ */
+void
+ae_setquery(const ae_set_t *set, ae_setquery_t *q)
+{
+	setquery(set, NULL, q);
+}
+
+/*
+ *	B A T C H S E T
+ */
+static void
+batchset(const batch_t *b, size_t n)
+{
+	setquery(b->set, b->snap, &b->sqv[n]);
+}
+
+/*
+ *		A E _ S E T B A T C H
+ *
+ * evaluates <qn> queries with the ranking of
+ * ae_setquery() over one snapshot of the set:
+ * the segments loaded when it is called, the
+ * others are skipped by every query even if
+ * they finish meanwhile. spread over <nthreads>
+ * threads like ae_batch(). returns -1 if out
+ * of memory
+ */
+int
+ae_setbatch(const ae_set_t *set, ae_setquery_t *qv, size_t qn, int nthreads)
+{
+	batch_t b = { batchset, NULL, NULL, set, NULL, qv };
+	bool *snap;
+	size_t n;
+	int ret;
+
+	if (!(snap = calloc(set->siz + 1, sizeof(bool))))
+		return -1;
+	for (n = 0; n < set->siz; n++)
+		snap[n] = ae_isready(set->sv[n]);
+
+	b.snap = snap;
+	ret = batchrun(&b, qn, nthreads);
+	free(snap);
+
+	return ret;
+}